@@ -1,4 +1,6 @@
 #pragma once
 
+#include <FIoC/StaticRegistration.h>
 #include <FIoC/Registry.h>
-#include <FIoC/TBRegistry.h>
\ No newline at end of file
+#include <FIoC/TBRegistry.h>
+#include <FIoC/TBRowRegistry.h>
\ No newline at end of file
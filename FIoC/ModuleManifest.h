@@ -0,0 +1,164 @@
+#pragma once
+
+#include <FIoC/TypeKey.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstddef>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#define FIOC_DETAIL_DEFINED_NOMINMAX
+#endif
+#include <windows.h>
+#ifdef FIOC_DETAIL_DEFINED_NOMINMAX
+#undef NOMINMAX
+#undef FIOC_DETAIL_DEFINED_NOMINMAX
+#endif
+#else
+#include <dlfcn.h>
+#endif
+
+/**
+ * Exports the module entry point with the C linkage so ModuleManifest can find it by its plain name.
+ * \code{.cpp}
+ * FIOC_MODULE_ENTRY void registerCodecs(fioc::Registry<std::map>& registry)
+ * {
+ *    registry.registerType<Codec>().as<ZipCodec>();
+ * }
+ * \endcode
+ */
+#if defined(_WIN32)
+#define FIOC_MODULE_ENTRY extern "C" __declspec(dllexport)
+#else
+#define FIOC_MODULE_ENTRY extern "C" __attribute__((visibility("default")))
+#endif
+
+namespace fioc
+{
+   namespace detail
+   {
+#if defined(_WIN32)
+      inline void* openLibrary(const std::string& path) { return reinterpret_cast<void*>(LoadLibraryA(path.c_str())); }
+      inline void* librarySymbol(void* library, const std::string& name) { return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(library), name.c_str())); }
+      inline std::string libraryError() { return "error " + std::to_string(GetLastError()); }
+#else
+      inline void* openLibrary(const std::string& path) { return dlopen(path.c_str(), RTLD_NOW | RTLD_GLOBAL); }
+      inline void* librarySymbol(void* library, const std::string& name) { return dlsym(library, name.c_str()); }
+      inline std::string libraryError() { const char* error = dlerror(); return error ? error : "unknown error"; }
+#endif
+   }
+
+   /**
+    * Maps the type keys to the shared libraries (modules) that register them, so the plugins are loaded only when
+    * the application asks for one of their types for the first time. The entry point of the module is a function
+    * exported by FIOC_MODULE_ENTRY that takes the registry and registers the module types into it.
+    * \code{.cpp}
+    * fioc::Registry<std::map> builder;
+    * fioc::ModuleManifest<fioc::Registry<std::map>> modules;
+    * modules.add<Codec, Compressor>("libcodecs.so", "registerCodecs");
+    * modules.attach(builder);
+    * unique_ptr<Codec> codec(builder.resolve<Codec>()); //loads libcodecs.so, calls registerCodecs(builder) and resolves again
+    * \endcode
+    *
+    * Each module is loaded at most once, also when the loading or the entry point fails (see lastError()). The modules
+    * are never unloaded because the registered factories and the created objects live in them. The manifest has to
+    * outlive the resolve calls of the attached registry.
+    *
+    * Without RTTI the type keys are addresses of the static variables, so the executable has to export its symbols
+    * (-rdynamic, ENABLE_EXPORTS in CMake) for the module to see the same keys.
+    *
+    * The header isn't included by FIoC.h and the FIoC target doesn't link the dynamic loader. The code using the manifest links
+    * it itself (${CMAKE_DL_LIBS} in CMake, -ldl with the older glibc).
+    *
+    * \tparam RegistryType Registry or TBRegistry the modules register to. The entry point takes it by reference.
+    */
+   template<typename RegistryType>
+   class ModuleManifest
+   {
+   public:
+      using EntryPoint = void (*)(RegistryType&);
+
+      /**
+       * Declares that the library registers the types Keys (resolve keys of the Registry or key types of the TBRegistry)
+       * through the entry point.
+       */
+      template<typename ...Keys>
+      ModuleManifest& add(const std::string& library, const std::string& entryPoint)
+      {
+         std::size_t index = 0;
+         while(index < modules.size() && (modules[index].library != library || modules[index].entryPoint != entryPoint))
+         {
+            ++index;
+         }
+         if(index == modules.size())
+         {
+            modules.push_back(Module{library, entryPoint});
+         }
+         (moduleOf.insert_or_assign(typeKey<Keys>(), index), ...);
+         return *this;
+      }
+
+      /**
+       * Makes the registry load the modules of this manifest when it doesn't find the requested type.
+       */
+      void attach(RegistryType& registry)
+      {
+         registry.setMissHandler([this, &registry](const TypeKey& key) { return load(key, registry); });
+      }
+
+      /**
+       * Loads the module declared for the key (if it hasn't been loaded yet) and runs its entry point on the registry.
+       *
+       * \return True when the entry point has been run, so the registry should search for the key again.
+       */
+      bool load(const TypeKey& key, RegistryType& registry)
+      {
+         auto it = moduleOf.find(key);
+         if(it == moduleOf.end())
+         {
+            return false;
+         }
+         Module& module = modules[it->second];
+         if(module.loaded)
+         {
+            return false;
+         }
+         module.loaded = true;
+
+         void* library = detail::openLibrary(module.library);
+         if(!library)
+         {
+            error = module.library + ": " + detail::libraryError();
+            return false;
+         }
+         EntryPoint entryPoint = reinterpret_cast<EntryPoint>(detail::librarySymbol(library, module.entryPoint));
+         if(!entryPoint)
+         {
+            error = module.library + ": " + detail::libraryError();
+            return false;
+         }
+         entryPoint(registry);
+         return true;
+      }
+
+      /**
+       * \return Description of the last failed module load or empty string.
+       */
+      const std::string& lastError() const { return error; }
+
+   protected:
+      struct Module
+      {
+         std::string library;
+         std::string entryPoint;
+         bool loaded = false;
+      };
+
+      std::vector<Module> modules;
+      std::map<TypeKey, std::size_t> moduleOf;
+      std::string error;
+   };
+}
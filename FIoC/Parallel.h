@@ -0,0 +1,104 @@
+#pragma once
+
+#include <FIoC/TBRegistry.h>
+
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+namespace fioc
+{
+   namespace detail
+   {
+      /**
+       * Joins the threads when leaving the scope, also by an exception.
+       */
+      class JoinGuard
+      {
+      public:
+         explicit JoinGuard(std::vector<std::thread>& threads)
+            : threads(threads)
+         {}
+
+         ~JoinGuard()
+         {
+            for(std::thread& thread : threads)
+            {
+               if(thread.joinable())
+               {
+                  thread.join();
+               }
+            }
+         }
+
+      protected:
+         std::vector<std::thread>& threads;
+      };
+   }
+
+   /**
+    * Execution policy of the batched resolves (TBRegistry::resolveByInstances()). The work is split among the given number of threads.
+    * It has its own header, so only the code using it needs the thread library (Threads::Threads in CMake).
+    * \code{.cpp}
+    * builder.resolveByInstances(fioc::Parallel{4}, models.begin(), models.end(), views.begin());
+    * \endcode
+    */
+   struct Parallel : ExecutionPolicy
+   {
+      explicit Parallel(unsigned threads = std::thread::hardware_concurrency())
+         : threads(threads)
+      {}
+
+      /**
+       * Calls build(begin, end) for the contiguous parts of [0, count), one part per thread (the calling thread builds the first one).
+       * When a part throws, it stops there, the other parts are finished and the first exception is rethrown after all
+       * the threads are joined.
+       */
+      template<typename Build>
+      void run(std::size_t count, const Build& build) const
+      {
+         std::size_t parts = std::min<std::size_t>(std::max(threads, 1u), count);
+         if(parts <= 1)
+         {
+            build(0, count);
+            return;
+         }
+
+         std::size_t chunk = (count + parts - 1) / parts;
+         std::vector<std::exception_ptr> errors(parts);
+         auto buildPart = [&build, &errors](std::size_t part, std::size_t begin, std::size_t end)
+         {
+            try
+            {
+               build(begin, end);
+            }
+            catch(...)
+            {
+               errors[part] = std::current_exception();
+            }
+         };
+
+         {
+            std::vector<std::thread> workers;
+            detail::JoinGuard guard(workers);
+            for(std::size_t begin = chunk, part = 1; begin < count; begin += chunk, ++part)
+            {
+               workers.emplace_back(buildPart, part, begin, std::min(begin + chunk, count));
+            }
+            buildPart(0, 0, chunk);
+         }
+
+         for(const std::exception_ptr& error : errors)
+         {
+            if(error)
+            {
+               std::rethrow_exception(error);
+            }
+         }
+      }
+
+      unsigned threads;
+   };
+}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <FIoC/commons.h>
+#include <FIoC/TypeKey.h>
+#include <FIoC/StaticRegistration.h>
 
-#include <typeindex>
 #include <memory>
+#include <optional>
+#include <new>
 
 namespace fioc
 {
@@ -39,15 +42,15 @@ namespace fioc
     * \see main.cpp
     *
     * \tparam _Map Customizable container implementation. Should satisfy AssociativeContainer or UnorderedAssociativeContainer like std::map or std::unordered map.
-    * \tparam Args Remaining template arguments the _Map type can have in addition to key and value type.
+    * \tparam MapArgs Remaining template arguments the _Map type can have in addition to key and value type.
     */
-   template <template <typename ... > class _Map, typename ...Args>
+   template <template <typename ... > class _Map, typename ...MapArgs>
    class Registry
    {
    public:
-      using Key = std::type_index;
+      using Key = TypeKey;
       using Value = std::unique_ptr<DefaultConstructorFunctor>;
-      using Map = _Map< Key, Value, Args ...>; //< The type of internal container (might come in handy)
+      using Map = _Map< Key, Value, MapArgs ...>; //< The type of internal container (might come in handy)
 
 
       /**
@@ -57,23 +60,128 @@ namespace fioc
        * \tparam T Type of requested object.
        * \tparam Args Arguments to the registered constructor. Must be the same as the registerType call. Compiler infers them automatically.
        * \param args Actual arguments to the constructor. The types mus be exact. No implicit conversion here due to the template resolution.
-       * \return The pointer to a newly created object (the caller assumes the ownership) or null if the type hasn't been registered.
+       * \return The pointer to a newly created object (the caller assumes the ownership) or null if the type hasn't been registered
+       *         or it has been registered with different constructor arguments.
        *
        * \see Builder
        */
       template<typename T, typename ... Args >
       T* resolve(Args... args)
       {
-         auto it = container.find(Key{typeid(T)});
-         if(it == container.end())
+         FactoryFor<T*, Args...> *factoryFunctor = findFactory<T, Args...>();
+         if(!factoryFunctor)
          {
             return nullptr;
          }
-         FactoryFunctor<T*, Args...> *factoryFunctor = static_cast<FactoryFunctor<T*, Args...> *>(it->second.get());
          return factoryFunctor->f(args...);
 
       }
 
+      /**
+       * Constructs the object of the requested type in the storage supplied by the caller. No allocation takes place.
+       * The storage has to be at least sizeOf<T>() bytes big and aligned to alignOf<T>(). The caller is responsible
+       * for calling the destructor of the returned object (not delete).
+       * \code{.cpp}
+       * alignas(std::max_align_t) unsigned char storage[64];
+       * if(builder.sizeOf<A>() <= sizeof(storage) && builder.alignOf<A>() <= alignof(std::max_align_t))
+       * {
+       *    A* a = builder.resolveInto<A>(storage);
+       *    a->~A();
+       * }
+       * \endcode
+       *
+       * \return The pointer to the object constructed in the storage or null if the type hasn't been registered, it has been registered
+       *         with different constructor arguments or with a custom factory (buildWithFactory) that can't construct in place.
+       */
+      template<typename T, typename ... Args >
+      T* resolveInto(void* storage, Args... args)
+      {
+         FactoryFor<T*, Args...> *factoryFunctor = findFactory<T, Args...>();
+         if(!factoryFunctor || !factoryFunctor->place)
+         {
+            return nullptr;
+         }
+         return factoryFunctor->place(storage, args...);
+      }
+
+      /**
+       * \return Size of the storage needed by resolveInto<T>() (the size of the registered implementation type) or 0 if the type
+       *         hasn't been registered or can't be constructed in place. The miss handler is asked the same way as by resolveInto(),
+       *         so the size is the one of the type resolveInto() is going to construct.
+       */
+      template<typename T>
+      std::size_t sizeOf()
+      {
+         DefaultConstructorFunctor* functor = findFunctor(typeKey<T>());
+         return functor ? functor->size : 0;
+      }
+
+      /**
+       * \return Alignment of the storage needed by resolveInto<T>() or 0 if the type hasn't been registered or can't be constructed in place.
+       */
+      template<typename T>
+      std::size_t alignOf()
+      {
+         DefaultConstructorFunctor* functor = findFunctor(typeKey<T>());
+         return functor ? functor->alignment : 0;
+      }
+
+      /**
+       * Constructs the object of the requested type and returns it by value. It is meant for small types bound to themselves
+       * (no as<>() to a different type) so the object can live on the stack or inside another object without allocation.
+       *
+       * \tparam T Type of requested object. It has to be final or non-polymorphic so it can't be sliced.
+       * \return The object or empty optional if the type hasn't been registered (with these arguments), it has been registered as another type
+       *         or with a custom factory (buildWithFactory) whose result type isn't known.
+       */
+      template<typename T, typename ... Args >
+      std::optional<T> resolveValue(Args... args)
+      {
+         static_assert(std::is_final_v<T> || !std::is_polymorphic_v<T>, "resolveValue() would slice the object. T has to be final or non-polymorphic.");
+         static_assert(std::is_move_constructible_v<T>, "resolveValue() needs move constructible type (the optional is returned by value).");
+
+         FactoryFor<T*, Args...> *factoryFunctor = findFactory<T, Args...>();
+         if(!factoryFunctor || !factoryFunctor->emplace || factoryFunctor->implementation != typeKey<T>())
+         {
+            return std::nullopt;
+         }
+
+         std::optional<T> result;
+         factoryFunctor->emplace(&result, args...);
+         return result;
+      }
+
+
+      /**
+       * Constructs the object of the requested type owned by the std::shared_ptr. The object and its control block are allocated
+       * together like with std::make_shared (also for the types registered by as<>()), from the shared pool when it is set.
+       * The types registered with weakSingleton() return the same instance until all of its users release it.
+       * Custom factories (buildWithFactory()) return raw pointers, so they need a separate control block allocation.
+       *
+       * \return The shared object or null if the type hasn't been registered or it has been registered with different constructor arguments.
+       */
+      template<typename T, typename ... Args >
+      std::shared_ptr<T> resolveShared(Args... args)
+      {
+         FactoryFor<T*, Args...> *factoryFunctor = findFactory<T, Args...>();
+         if(!factoryFunctor)
+         {
+            return nullptr;
+         }
+         return factoryFunctor->createShared(sharedPool, args...);
+      }
+
+      /**
+       * Sets the memory resource resolveShared() allocates the objects from. The registry and every created object hold the pool,
+       * so it lives as long as any of them. Pass null to use the default allocation again.
+       * \code{.cpp}
+       * builder.setSharedPool(std::make_shared<std::pmr::synchronized_pool_resource>());
+       * \endcode
+       */
+      void setSharedPool(std::shared_ptr<std::pmr::memory_resource> pool)
+      {
+         sharedPool = std::move(pool);
+      }
 
       /**
        * This is intermediate return structure from the registerType() method.
@@ -81,11 +189,12 @@ namespace fioc
        * for the later resolution (mocking).
        *
        * \tparam T Original type we are mocking.
+       * \tparam Impl Type that gets constructed by the chained buildWithConstructor() call.
        */
-      template<typename T>
+      template<typename T, typename Impl = T>
       struct IntermediateReturn
       {
-         using type = typename T;
+         using type = T;
 
          IntermediateReturn(Map &c) :container(c) {}
 
@@ -98,41 +207,42 @@ namespace fioc
           * \see Builder for example usages.
           */
          template<typename As>
-         IntermediateReturn<T> as()
+         IntermediateReturn<T, As> as()
          {
             static_assert(std::is_base_of_v<T, As>, "Template type As is not a subclass of T");
 
-            FactoryFunctor<T*> *factoryFunctor;
-
-            if constexpr(std::is_default_constructible_v<As>)
-            {
-               factoryFunctor = new FactoryFunctor<T*>();
-               factoryFunctor->f = []() { return new As(); };
-            }
-            else
-            {
-               factoryFunctor = new NullFactory<T*>();
-            }
+            container.insert_or_assign(typeKey<T>(), Value{makeDefaultFactory<T, As>()});
 
-            container.insert_or_assign(Key{typeid(T)}, Value{factoryFunctor});
+            return IntermediateReturn<T, As>{container};
+         }
 
+         template<typename ...Args>
+         IntermediateReturn<T, Impl> buildWithConstructor()
+         {
+            container.insert_or_assign(typeKey<T>(), Value{fioc::makeConstructorFactory<T, Impl, Args...>()});
             return *this;
          }
 
          template<typename ...Args>
-         void buildWithConstructor()
+         IntermediateReturn<T, Impl> buildWithFactory(std::function<T*(Args...)> f)
          {
-            FactoryFunctor<T*, Args...> *factoryFunctor = new FactoryFunctor<T*, Args...>();
-            factoryFunctor->f = [](Args... args) { return new T(args...); };
-            container.insert_or_assign(Key{typeid(T)}, Value{factoryFunctor});
+            container.insert_or_assign(typeKey<T>(), Value{fioc::makeCustomFactory(std::move(f))});
+            return *this;
          }
 
-         template<typename ...Args>
-         void buildWithFactory(std::function<T*(Args...)> f)
+         /**
+          * Makes resolveShared() of T return the living instance instead of creating a new one. The instance is created again
+          * (with the arguments of that call) only after all of its users release it. It has to be the last call of the chain.
+          * resolve() and resolveInto() still create new objects.
+          *
+          * resolveShared() of the weak singleton may be called from several threads at once (once the registration is done):
+          * the lookup of the living instance and its creation are serialized by a mutex of the binding, so all the threads get
+          * the same instance. The constructor of the singleton must not resolve the same binding again (it would deadlock).
+          */
+         IntermediateReturn<T, Impl> weakSingleton()
          {
-            FactoryFunctor<T*, Args...> *factoryFunctor = new FactoryFunctor<T*, Args...>();
-            factoryFunctor->f = f;
-            container.insert_or_assign(Key{typeid(T)}, Value{factoryFunctor});
+            container.find(typeKey<T>())->second->weakSingleton = true;
+            return *this;
          }
 
       protected:
@@ -151,24 +261,79 @@ namespace fioc
       template<typename T>
       IntermediateReturn<T> registerType()
       {
-         FactoryFunctor<T*> *factoryFunctor;
+         container.insert_or_assign(typeKey<T>(), Value{makeDefaultFactory<T, T>()});
+         return IntermediateReturn<T>{container};
+      }
+
+      /**
+       * Sets the function called when the requested type isn't registered. When it returns true the type is searched
+       * again, so the handler can register it on demand (see ModuleManifest::attach()).
+       */
+      void setMissHandler(std::function<bool(const Key&)> handler)
+      {
+         missHandler = std::move(handler);
+      }
+
+      /**
+       * Registers all the bindings declared by FIOC_REGISTER_TYPE(Tag, ...) in one bulk insert. Call it after the static
+       * initialization (e.g. from main). The static registrations replace the existing ones of the same type.
+       * When one type is declared more than once in the list, which one wins is unspecified (as is the static initialization order).
+       *
+       * \tparam Tag The tag the bindings were declared with.
+       */
+      template<typename Tag>
+      void registerStatic()
+      {
+         detail::registerStatic(container, StaticRegistration<Tag>::first(), StaticRegistration<Tag>::size());
+      }
 
-         if constexpr(std::is_default_constructible_v<T>)
+   protected:
+      /**
+       * \return The functor registered for the key (asking the miss handler when there is none) or null.
+       */
+      DefaultConstructorFunctor* findFunctor(const Key& key)
+      {
+         auto it = container.find(key);
+         if(it == container.end() && missHandler && missHandler(key))
          {
-            factoryFunctor = new FactoryFunctor<T*>();
-            factoryFunctor->f = []() { return new T(); };
+            it = container.find(key);
          }
-         else
+         return it == container.end() ? nullptr : it->second.get();
+      }
+
+      /**
+       * \return The registered functor for T if its signature matches Args otherwise null.
+       */
+      template<typename T, typename ... Args >
+      FactoryFor<T*, Args...>* findFactory()
+      {
+         DefaultConstructorFunctor* functor = findFunctor(typeKey<T>());
+         if(!functor || functor->signature != FactoryFor<T*, Args...>::signatureKey())
          {
-            factoryFunctor = new NullFactory<T*>();
+            return nullptr;
          }
+         return static_cast<FactoryFor<T*, Args...> *>(functor);
+      }
 
-         container.insert_or_assign(Key{typeid(T)}, Value{factoryFunctor});
-         return IntermediateReturn<T>{container};
+      /**
+       * Creates the functor with the default constructor of Impl or the one that resolves to nullptr when Impl is not default constructible.
+       */
+      template<typename T, typename Impl>
+      static FactoryFor<T*>* makeDefaultFactory()
+      {
+         if constexpr(std::is_default_constructible_v<Impl>)
+         {
+            return fioc::makeConstructorFactory<T, Impl>();
+         }
+         else
+         {
+            return new NullFactory<T*>();
+         }
       }
 
-   protected:
       Map container; //< Map is e.g. std::map<std::string, std::function<void*()> >. container holds the factory functions
+      std::function<bool(const Key&)> missHandler;
+      std::shared_ptr<std::pmr::memory_resource> sharedPool;
    };
 
 }
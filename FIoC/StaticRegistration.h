@@ -0,0 +1,185 @@
+#pragma once
+
+#include <FIoC/commons.h>
+#include <FIoC/TypeKey.h>
+
+#include <utility>
+#include <cstddef>
+
+namespace fioc
+{
+   /**
+    * Binding of the static registration for the Registry. Resolving T constructs Impl with the constructor taking Args.
+    */
+   template<typename T, typename Impl = T, typename ...Args>
+   struct Bind
+   {
+   };
+
+   /**
+    * Binding of the static registration for the TBRegistry. Resolving BindType (or its instance) constructs CreatedType
+    * with the constructor taking Args.
+    */
+   template<typename CreatedType, typename BindType, typename ...Args>
+   struct BindFor
+   {
+   };
+
+   /**
+    * One node of the static registration list. The nodes are static objects that link themselves to the list of their tag
+    * when they are initialized, so nothing is allocated at the static initialization time. The factories are created
+    * later by the bulk registration (Registry::registerStatic(), TBRegistry::registerStatic()).
+    */
+   class StaticRegistrationNode
+   {
+   public:
+      TypeKey key() const { return keyFunction(); }
+      DefaultConstructorFunctor* createFactory() const { return factoryFunction(); }
+      const StaticRegistrationNode* next() const { return nextNode; }
+
+   protected:
+      StaticRegistrationNode(TypeKey (*keyFunction)(), DefaultConstructorFunctor* (*factoryFunction)(), const StaticRegistrationNode*& head, std::size_t& count)
+         : keyFunction(keyFunction)
+         , factoryFunction(factoryFunction)
+         , nextNode(head)
+      {
+         head = this;
+         ++count;
+      }
+
+      template<typename R, typename Impl, typename ...Args>
+      static DefaultConstructorFunctor* makeFactory()
+      {
+         static_assert(std::is_constructible_v<Impl, Args...>, "The registered type has no constructor taking the given arguments.");
+         return makeConstructorFactory<R, Impl, Args...>();
+      }
+
+      TypeKey (*keyFunction)();
+      DefaultConstructorFunctor* (*factoryFunction)();
+      const StaticRegistrationNode* nextNode;
+   };
+
+   /**
+    * Static registration for the Registry. Use it through the FIOC_REGISTER_TYPE macro.
+    *
+    * \tparam Tag Any type naming the list, so the application can keep several independent lists.
+    */
+   template<typename Tag>
+   class StaticRegistration : public StaticRegistrationNode
+   {
+   public:
+      template<typename T, typename Impl, typename ...Args>
+      StaticRegistration(Bind<T, Impl, Args...>)
+         : StaticRegistrationNode(&typeKey<T>, &makeFactory<T, Impl, Args...>, head, count)
+      {
+         static_assert(std::is_base_of_v<T, Impl>, "Template type Impl is not a subclass of T");
+      }
+
+      static const StaticRegistrationNode* first() { return head; }
+      static std::size_t size() { return count; }
+
+   protected:
+      static inline const StaticRegistrationNode* head = nullptr;
+      static inline std::size_t count = 0;
+   };
+
+   /**
+    * Static registration for the TBRegistry with the given CommonType. Use it through the FIOC_REGISTER_TYPE_FOR macro.
+    *
+    * \tparam Tag Any type naming the list.
+    * \tparam CommonType Must be the same as the CommonType of the TBRegistry the list is registered to.
+    */
+   template<typename Tag, typename CommonType = void>
+   class StaticTBRegistration : public StaticRegistrationNode
+   {
+   public:
+      template<typename CreatedType, typename BindType, typename ...Args>
+      StaticTBRegistration(BindFor<CreatedType, BindType, Args...>)
+         : StaticRegistrationNode(&typeKey<BindType>, &makeFactory<CommonType, CreatedType, Args...>, head, count)
+      {
+      }
+
+      static const StaticRegistrationNode* first() { return head; }
+      static std::size_t size() { return count; }
+
+   protected:
+      static inline const StaticRegistrationNode* head = nullptr;
+      static inline std::size_t count = 0;
+   };
+
+   namespace detail
+   {
+      template<typename Map, typename = void>
+      struct HasReserve : std::false_type {};
+
+      template<typename Map>
+      struct HasReserve<Map, std::void_t<decltype(std::declval<Map&>().reserve(std::size_t{}))>> : std::true_type {};
+
+      /**
+       * Creates the factories of the whole list and inserts them in one go. The container is presized when it supports it
+       * (std::unordered_map), so there is no rehashing on the way.
+       */
+      template<typename Map>
+      void registerStatic(Map& container, const StaticRegistrationNode* node, std::size_t count)
+      {
+         using Value = typename Map::mapped_type;
+
+         if constexpr(HasReserve<Map>::value)
+         {
+            container.reserve(container.size() + count);
+         }
+         for(; node; node = node->next())
+         {
+            container.insert_or_assign(node->key(), Value{node->createFactory()});
+         }
+      }
+   }
+}
+
+#define FIOC_DETAIL_CONCAT_(a, b) a##b
+#define FIOC_DETAIL_CONCAT(a, b) FIOC_DETAIL_CONCAT_(a, b)
+
+/**
+ * Registers the binding for the Registry at the static initialization time. Use it at the namespace scope of a source file (not a header).
+ * The arguments after the tag are the ones of fioc::Bind: the requested type, the implementation type and the constructor arguments.
+ * \code{.cpp}
+ * FIOC_REGISTER_TYPE(AppTypes, A);                                  // A as A
+ * FIOC_REGISTER_TYPE(AppTypes, A, C);                               // A implemented by C
+ * FIOC_REGISTER_TYPE(AppTypes, NoDefaultCtor, NoDefaultCtorSub, int, int);
+ * ...
+ * fioc::Registry<std::map> builder;
+ * builder.registerStatic<AppTypes>();                               // in main, after the static initialization
+ * \endcode
+ *
+ * There are two pitfalls of the static registration (both apply to FIOC_REGISTER_TYPE_FOR too):
+ * - When the source file with the registrations is linked from a static library and nothing else from it is referenced,
+ *   the linker drops the whole object file and its registrations never run. Define an anchor function in that file and
+ *   call it from the application (or link the library with --whole-archive, /WHOLEARCHIVE).
+ * - The lists are complete only after the static initialization. registerStatic() called from a dynamic initializer
+ *   of another source file (e.g. a global registry filled in its constructor) sees only the files initialized before it,
+ *   whose order is unspecified. Call it from main or later.
+ * \code{.cpp}
+ * // AppTypes.cpp, part of a static library
+ * FIOC_REGISTER_TYPE(AppTypes, A, C);
+ * void linkAppTypes() {}                                            // anchor, declared in AppTypes.h
+ *
+ * // main.cpp
+ * linkAppTypes();                                                   // keeps AppTypes.cpp (and its registrations) in the executable
+ * builder.registerStatic<AppTypes>();
+ * \endcode
+ */
+#define FIOC_REGISTER_TYPE(Tag, ...) \
+   static const ::fioc::StaticRegistration<Tag> FIOC_DETAIL_CONCAT(fiocStaticRegistration, __COUNTER__){::fioc::Bind<__VA_ARGS__>{}}
+
+/**
+ * Registers the binding for the TBRegistry with the given CommonType at the static initialization time (see FIOC_REGISTER_TYPE for the pitfalls).
+ * The arguments after the common type are the ones of fioc::BindFor: the created type, the key type and the constructor arguments.
+ * \code{.cpp}
+ * FIOC_REGISTER_TYPE_FOR(AppViews, AbstractView, BView, B);         // BView is created for B
+ * ...
+ * fioc::TBRegistry<std::map, AbstractView> views;
+ * views.registerStatic<AppViews>();
+ * \endcode
+ */
+#define FIOC_REGISTER_TYPE_FOR(Tag, CommonType, ...) \
+   static const ::fioc::StaticTBRegistration<Tag, CommonType> FIOC_DETAIL_CONCAT(fiocStaticRegistration, __COUNTER__){::fioc::BindFor<__VA_ARGS__>{}}
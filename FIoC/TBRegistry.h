@@ -1,14 +1,40 @@
 #pragma once
 
 #include <FIoC/commons.h>
+#include <FIoC/TypeKey.h>
+#include <FIoC/StaticRegistration.h>
 
-#include <typeindex>
 #include <memory>
+#include <vector>
+#include <map>
 
 #include <iostream>
 
 namespace fioc
 {
+   /**
+    * Base of the execution policies of the batched resolves (TBRegistry::resolveByInstances()), e.g. fioc::Parallel from FIoC/Parallel.h.
+    * A policy has run(count, build) that calls build(begin, end) for the parts covering [0, count).
+    */
+   struct ExecutionPolicy
+   {
+   };
+
+   namespace detail
+   {
+      template<typename T>
+      T* instancePointer(T* instance)
+      {
+         return instance;
+      }
+
+      template<typename Pointer>
+      auto instancePointer(const Pointer& instance) -> decltype(instance.get())
+      {
+         return instance.get();
+      }
+   }
+
    /**
     * Class that serves as a IoC builder registry but the type that is build doesn't need to relate to the type that is 'requested'.
     * It aims to provide a binding for two classes that are used together but one doesn't need to depend on another. It can be also used
@@ -50,50 +76,151 @@ namespace fioc
     * 
     * There has to be a certain order of the calls int the chains otherwise the item don't get registered or the resolve could return nullptr or
     * a not expected result. For example if you register type A to be resolved with a constructor/factory taking one int as a parameter and you 
-    * don't supply it/them to the resolve call, you might get anything from possible crash (if the type A is badly designed), nullptr, default values
-    * passed to the factory/ctor (first use) or the parameters of the last resolve call (that got saved there in the wrapper functor).
+    * don't supply it/them to the resolve call, the resolve returns nullptr.
+    * 
+    * Without RTTI (-fno-rtti, or FIOC_NO_RTTI defined) the keys are generated by fioc::typeKey() and the resolveByInstance() needs
+    * the FIOC_TYPE_KEY hook in the polymorphic key classes to find out the dynamic type.
+    * \code{.cpp}
+    * class SuperClassOfB { public: FIOC_TYPE_KEY(SuperClassOfB) virtual ~SuperClassOfB() = default; };
+    * class B : public SuperClassOfB { public: FIOC_TYPE_KEY(B) };
+    * \endcode
     * 
     * \tparam _Map Customizable container implementation. Should satisfy AssociativeContainer or UnorderedAssociativeContainer like std::map or std::unordered map.
     * \tparam _CommonType The type that pointer to it should be returned by the resolve function. If not supplied the default is void.
     */
-   template <template <typename ... > class _Map, typename _CommonType = void, typename ...Args>
+   template <template <typename ... > class _Map, typename _CommonType = void, typename ...MapArgs>
    class TBRegistry
    {
    public:
       using CommonType = _CommonType;
-      using Key = std::type_index;
+      using Key = TypeKey;
       using Value = std::unique_ptr<DefaultConstructorFunctor>;
-      using Map = _Map< Key, Value, Args ...>; //< The type of internal container (might come in handy)
+      using Map = _Map< Key, Value, MapArgs ...>; //< The type of internal container (might come in handy)
 
       template<typename BindType, typename ...Args>
       CommonType* resolve(Args... args)
       {
-         auto it = container.find(Key{typeid(BindType)});
-         if(it == container.end())
+         FactoryFor<CommonType*, Args...> *factoryFunctor = findFactory<Args...>(typeKey<BindType>());
+         if(!factoryFunctor)
          {
             return nullptr;
          }
-         FactoryFunctor<CommonType*, Args...> *factoryFunctor = static_cast<FactoryFunctor<CommonType*, Args...> *>(it->second.get());
          return factoryFunctor->f(args...);
       }
 
       template<typename T, typename ...Args>
       CommonType* resolveByInstance(T* instance, Args...args)
       {
-         Key key{typeid(*instance)};
-         auto it = container.find(key);
-         if(it == container.end())
+         FactoryFor<CommonType*, Args...> *factoryFunctor = findFactory<Args...>(instanceTypeKey(instance));
+         if(!factoryFunctor)
          {
             return nullptr;
          }
-         FactoryFunctor<CommonType*, Args...> *factoryFunctor = static_cast<FactoryFunctor<CommonType*, Args...> *>(it->second.get());
          return factoryFunctor->f(args...);
       }
 
-      template<typename CreatedType, bool isConstructible, typename...Args>
+      /**
+       * resolve() returning the object owned by the std::shared_ptr. The object and its control block are allocated together
+       * (from the shared pool when it is set). Bindings registered with weakSingleton() return the same instance until all
+       * of its users release it. Custom factories (buildWithFactory()) need a separate control block allocation and
+       * they are not supported with the void CommonType (the result is null).
+       */
+      template<typename BindType, typename ...Args>
+      std::shared_ptr<CommonType> resolveShared(Args... args)
+      {
+         FactoryFor<CommonType*, Args...> *factoryFunctor = findFactory<Args...>(typeKey<BindType>());
+         if(!factoryFunctor)
+         {
+            return nullptr;
+         }
+         return factoryFunctor->createShared(sharedPool, args...);
+      }
+
+      /**
+       * resolveByInstance() returning the object owned by the std::shared_ptr. \see resolveShared()
+       */
+      template<typename T, typename ...Args>
+      std::shared_ptr<CommonType> resolveSharedByInstance(T* instance, Args...args)
+      {
+         FactoryFor<CommonType*, Args...> *factoryFunctor = findFactory<Args...>(instanceTypeKey(instance));
+         if(!factoryFunctor)
+         {
+            return nullptr;
+         }
+         return factoryFunctor->createShared(sharedPool, args...);
+      }
+
+      /**
+       * Sets the memory resource the shared resolves allocate the objects from. \see Registry::setSharedPool()
+       */
+      void setSharedPool(std::shared_ptr<std::pmr::memory_resource> pool)
+      {
+         sharedPool = std::move(pool);
+      }
+
+      /**
+       * Batched resolveByInstance(). Resolves every instance of the range [first, last) and writes the results to the output range
+       * in the same order. The instances are grouped by their dynamic type so the container is searched only once per distinct
+       * type of the batch. Null instances and unregistered types yield nullptr.
+       * \code{.cpp}
+       * std::vector<SuperClassOfB*> models = ...;
+       * std::vector<AbstractClass*> views(models.size());
+       * builder.resolveByInstances(models.begin(), models.end(), views.begin());
+       * builder.resolveByInstances(fioc::Parallel{}, models.begin(), models.end(), views.begin()); //same but multithreaded (FIoC/Parallel.h)
+       * \endcode
+       *
+       * \tparam InputIt Input iterator to raw or smart pointers to the key instances.
+       * \tparam OutputIt Output iterator to CommonType*. The caller assumes the ownership of the created objects.
+       * \param args Arguments passed to every factory call.
+       * \return Iterator past the last written element.
+       */
+      template<typename InputIt, typename OutputIt, typename ...Args>
+      OutputIt resolveByInstances(InputIt first, InputIt last, OutputIt out, Args...args)
+      {
+         BatchGroups<Args...> groups(*this);
+         for(; first != last; ++first, ++out)
+         {
+            FactoryFor<CommonType*, Args...> *factoryFunctor = groups.factoryFor(detail::instancePointer(*first));
+            *out = factoryFunctor ? factoryFunctor->f(args...) : nullptr;
+         }
+         return out;
+      }
+
+      /**
+       * Batched resolveByInstance() run by the execution policy (fioc::Parallel splits the factory calls among threads).
+       * The factories of all the instances are looked up first (once per distinct type) and the policy then builds
+       * the contiguous parts of the output range. The registered factories have to be safe to call concurrently.
+       *
+       * \tparam Policy Subclass of ExecutionPolicy.
+       * \tparam OutputIt Random access iterator to CommonType*.
+       */
+      template<typename Policy, typename InputIt, typename OutputIt, typename ...Args>
+      std::enable_if_t<std::is_base_of_v<ExecutionPolicy, Policy>, OutputIt> resolveByInstances(const Policy& policy, InputIt first, InputIt last, OutputIt out, Args...args)
+      {
+         using Factory = FactoryFor<CommonType*, Args...>;
+
+         BatchGroups<Args...> groups(*this);
+         std::vector<Factory*> factories;
+         for(; first != last; ++first)
+         {
+            factories.push_back(groups.factoryFor(detail::instancePointer(*first)));
+         }
+
+         policy.run(factories.size(), [&factories, &out, &args...](std::size_t begin, std::size_t end)
+         {
+            for(std::size_t i = begin; i < end; ++i)
+            {
+               out[i] = factories[i] ? factories[i]->f(args...) : nullptr;
+            }
+         });
+
+         return out + factories.size();
+      }
+
+      template<typename CreatedType, bool isConstructible, typename...FactoryArgs>
       struct IntermediateReturn
       {
-         IntermediateReturn(Map& map, std::unique_ptr<FactoryFunctor<CommonType*, Args...>> ff)
+         IntermediateReturn(Map& map, std::unique_ptr<FactoryFor<CommonType*, FactoryArgs...>> ff)
             : container(map)
          {
             factoryFunctor = std::move(ff);
@@ -103,23 +230,33 @@ namespace fioc
          void forType()
          {
             static_assert(isConstructible, "The type you want to be build (CreatedType) has no appropriate construction method. Either register it with existing constructor or factory.\n\tThe common mistake is calling fioc.registerType<A>().forType<B>(); where A doesn't have a default constructor.");
-            container.insert_or_assign(Key{typeid(BindType)}, std::move(factoryFunctor));
+            container.insert_or_assign(typeKey<BindType>(), std::move(factoryFunctor));
          }
 
          template<typename...Args>
          IntermediateReturn<CreatedType, true, Args...> buildWithConstructor()
          {
-            std::unique_ptr<FactoryFunctor<CommonType*, Args...>> factoryFunctor = std::make_unique<FactoryFunctor<CommonType*, Args...>>();
-            factoryFunctor->f = [](Args... args) { return static_cast<CommonType*> (new CreatedType(args...)); };
+            std::unique_ptr<FactoryFor<CommonType*, Args...>> factoryFunctor{makeConstructorFactory<CommonType, CreatedType, Args...>()};
 
             return IntermediateReturn<CreatedType, true, Args...>(container, std::move(factoryFunctor));
          }
 
+         /**
+          * Makes the shared resolves of the binding return the living instance instead of creating a new one.
+          * The instance is created again only after all of its users release it. The shared resolves of the binding may run
+          * concurrently, the lookup and the creation of the instance are serialized by a mutex of the binding (the constructor
+          * must not resolve the same binding again). \see Registry::IntermediateReturn::weakSingleton()
+          */
+         IntermediateReturn weakSingleton()
+         {
+            factoryFunctor->weakSingleton = true;
+            return IntermediateReturn(container, std::move(factoryFunctor));
+         }
+
          template<typename ...Args>
          IntermediateReturn<CreatedType, true, Args...> buildWithFactory(std::function<CommonType*(Args...)> f)
          {
-            std::unique_ptr<FactoryFunctor<CommonType*, Args...>> factoryFunctor = std::make_unique<FactoryFunctor<CommonType*, Args...>>();
-            factoryFunctor->f = f;
+            std::unique_ptr<FactoryFor<CommonType*, Args...>> factoryFunctor{makeCustomFactory(std::move(f))};
 
             return IntermediateReturn<CreatedType, true, Args...>(container, std::move(factoryFunctor));
          }
@@ -127,18 +264,17 @@ namespace fioc
       protected:
 
          Map& container;
-         std::unique_ptr<FactoryFunctor<CommonType*, Args...>> factoryFunctor;
+         std::unique_ptr<FactoryFor<CommonType*, FactoryArgs...>> factoryFunctor;
       };
 
       template<typename CreatedType>
       IntermediateReturn< CreatedType, std::is_default_constructible_v<CreatedType> > registerType()
       {
-         std::unique_ptr<FactoryFunctor<CommonType*>> factoryFunctor;
+         std::unique_ptr<FactoryFor<CommonType*>> factoryFunctor;
 
          if constexpr(std::is_default_constructible_v<CreatedType>)
          {
-            factoryFunctor = std::make_unique<FactoryFunctor<CommonType*>>();
-            factoryFunctor->f = []() ->CommonType* { return static_cast<CommonType*> (new CreatedType()); };
+            factoryFunctor.reset(makeConstructorFactory<CommonType, CreatedType>());
             return IntermediateReturn<CreatedType, true>{container, std::move(factoryFunctor)};
          }
          else
@@ -149,7 +285,89 @@ namespace fioc
       }
 
 
+      /**
+       * Sets the function called when the requested key type isn't registered. When it returns true the type is searched
+       * again, so the handler can register it on demand (see ModuleManifest::attach()).
+       */
+      void setMissHandler(std::function<bool(const Key&)> handler)
+      {
+         missHandler = std::move(handler);
+      }
+
+      /**
+       * Registers all the bindings declared by FIOC_REGISTER_TYPE_FOR(Tag, CommonType, ...) in one bulk insert. Call it after
+       * the static initialization (e.g. from main). The static registrations replace the existing ones of the same key type.
+       * When one key type is declared more than once in the list, which one wins is unspecified (as is the static initialization order).
+       *
+       * \tparam Tag The tag the bindings were declared with.
+       */
+      template<typename Tag>
+      void registerStatic()
+      {
+         detail::registerStatic(container, StaticTBRegistration<Tag, CommonType>::first(), StaticTBRegistration<Tag, CommonType>::size());
+      }
+
    protected:
+      /**
+       * \return The functor registered for the key if its signature matches Args otherwise null.
+       */
+      template<typename ...Args>
+      FactoryFor<CommonType*, Args...>* findFactory(const Key& key)
+      {
+         auto it = container.find(key);
+         if(it == container.end() && missHandler && missHandler(key))
+         {
+            it = container.find(key);
+         }
+         if(it == container.end() || it->second->signature != FactoryFor<CommonType*, Args...>::signatureKey())
+         {
+            return nullptr;
+         }
+         return static_cast<FactoryFor<CommonType*, Args...> *>(it->second.get());
+      }
+
+      /**
+       * Factories of the distinct types met during one batched resolve. The instances mostly come in runs of the same type,
+       * so the last group is tried first and then the table of the groups before the container is searched.
+       */
+      template<typename ...Args>
+      struct BatchGroups
+      {
+         using Factory = FactoryFor<CommonType*, Args...>;
+         using Table = std::map<Key, Factory*>;
+
+         explicit BatchGroups(TBRegistry& registry)
+            : registry(registry)
+            , last(factories.end())
+         {}
+
+         template<typename T>
+         Factory* factoryFor(T* instance)
+         {
+            if(!instance)
+            {
+               return nullptr;
+            }
+            Key key = instanceTypeKey(instance);
+            if(last == factories.end() || last->first != key)
+            {
+               auto [it, inserted] = factories.try_emplace(key, nullptr);
+               if(inserted)
+               {
+                  it->second = registry.template findFactory<Args...>(key);
+               }
+               last = it;
+            }
+            return last->second;
+         }
+
+         TBRegistry& registry;
+         Table factories;
+         typename Table::iterator last;
+      };
+
       Map container; //< Map is e.g. std::map<std::string, std::function<void*()> >. container holds the factory functions
+      std::function<bool(const Key&)> missHandler;
+      std::shared_ptr<std::pmr::memory_resource> sharedPool;
    };
 }
\ No newline at end of file
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <FIoC/commons.h>
+#include <FIoC/TypeKey.h>
+
+#include <memory>
+#include <array>
+
+namespace fioc
+{
+   namespace detail
+   {
+      /**
+       * Index of T in Ts or sizeof...(Ts) when T is not there.
+       */
+      template<typename T, typename ...Ts>
+      constexpr std::size_t indexOf()
+      {
+         std::size_t index = 0;
+         bool found = ((std::is_same_v<T, Ts> ? true : (++index, false)) || ...);
+         return found ? index : sizeof...(Ts);
+      }
+   }
+
+   /**
+    * List of the role tags of the TBRowRegistry.
+    */
+   template<typename ...RoleTags>
+   struct Roles
+   {
+   };
+
+   template <template <typename ... > class _Map, typename _Roles, typename ...MapArgs>
+   class TBRowRegistry;
+
+   /**
+    * Variant of the TBRegistry that builds a whole family of classes for one key type. Every key maps to a row of factories,
+    * one for each role (view, controller, serializer...). A role is a tag type naming the CommonType of the objects it creates.
+    * One lookup (resolveRow(), resolveByInstanceRow()) gives a handle that creates any role of the family without searching
+    * the container again.
+    *
+    * \code{.cpp}
+    * struct ViewRole { using CommonType = AbstractView; };
+    * struct ControllerRole { using CommonType = AbstractController; };
+    *
+    * fioc::TBRowRegistry<std::map, fioc::Roles<ViewRole, ControllerRole>> builder;
+    * builder.registerType<ViewRole, BView>().forType<B>();
+    * builder.registerType<ControllerRole, BController>().buildWithConstructor<int>().forType<B>();
+    *
+    * auto row = builder.resolveByInstanceRow(b); //one lookup
+    * AbstractView* view = row.create<ViewRole>();
+    * AbstractController* controller = row.create<ControllerRole>(4);
+    * \endcode
+    *
+    * The row stores its entries inline. A constructor binding is a signature key and a plain function pointer, only
+    * the custom factories (buildWithFactory()) keep their functor on the heap.
+    *
+    * The handle points to the row inside the container. It stays valid while the registry lives, and sees the later registrations
+    * for the same key, only when the container doesn't move its elements on insertion (node-based containers like std::map and
+    * std::unordered_map). With a flat container registering a new key type invalidates the handles.
+    *
+    * \tparam _Map Customizable container implementation. Should satisfy AssociativeContainer or UnorderedAssociativeContainer like std::map or std::unordered map.
+    * \tparam RoleTags Role tags given as fioc::Roles. Each one has to define the CommonType the created objects are returned as.
+    * \tparam MapArgs Remaining template arguments the _Map type can have in addition to key and value type.
+    */
+   template <template <typename ... > class _Map, typename ...RoleTags, typename ...MapArgs>
+   class TBRowRegistry<_Map, Roles<RoleTags...>, MapArgs...>
+   {
+   public:
+      /**
+       * Factory of one role of the row. The invoker is stored as a generic function pointer and it is cast back
+       * to the Invoker of the role and arguments only after the signature has been checked.
+       */
+      struct Entry
+      {
+         using GenericInvoker = void (*)();
+
+         template<typename CommonType, typename ...Args>
+         using Invoker = CommonType* (*)(const Entry&, std::decay_t<Args>&...);
+
+         TypeKey signature = typeKey<void>();
+         GenericInvoker invoke = nullptr;
+         std::unique_ptr<DefaultConstructorFunctor> custom; //< Functor of the custom factory, null for the constructor bindings.
+      };
+
+      using Key = TypeKey;
+      using Row = std::array<Entry, sizeof...(RoleTags)>;
+      using Map = _Map< Key, Row, MapArgs ...>; //< The type of internal container (might come in handy)
+
+      template<typename Role>
+      static constexpr std::size_t roleIndex()
+      {
+         constexpr std::size_t index = detail::indexOf<Role, RoleTags...>();
+         static_assert(index < sizeof...(RoleTags), "The role is not one of the Roles of this registry.");
+         return index;
+      }
+
+      /**
+       * Result of the row resolves. Creates the objects of the roles registered for the key type the row was resolved for.
+       */
+      class RowHandle
+      {
+      public:
+         explicit RowHandle(const Row* row = nullptr)
+            : row(row)
+         {}
+
+         /**
+          * \return False if the key type has no row.
+          */
+         explicit operator bool() const { return row != nullptr; }
+
+         /**
+          * \return True if there is a factory registered for the role.
+          */
+         template<typename Role>
+         bool has() const
+         {
+            return row && (*row)[roleIndex<Role>()].invoke;
+         }
+
+         /**
+          * Creates the object of the role.
+          *
+          * \return The new object (the caller assumes the ownership) or null if the role isn't registered for the key type
+          *         or it has been registered with different constructor arguments.
+          */
+         template<typename Role, typename ...Args>
+         typename Role::CommonType* create(Args... args) const
+         {
+            using CommonType = typename Role::CommonType;
+
+            if(!row)
+            {
+               return nullptr;
+            }
+            const Entry& entry = (*row)[roleIndex<Role>()];
+            if(!entry.invoke || entry.signature != FactoryFor<CommonType*, Args...>::signatureKey())
+            {
+               return nullptr;
+            }
+            return reinterpret_cast<typename Entry::template Invoker<CommonType, Args...>>(entry.invoke)(entry, args...);
+         }
+
+      protected:
+         const Row* row;
+      };
+
+      /**
+       * \return The row of the key type BindType. The handle is empty when nothing has been registered for it.
+       */
+      template<typename BindType>
+      RowHandle resolveRow() const
+      {
+         return findRow(typeKey<BindType>());
+      }
+
+      /**
+       * \return The row of the dynamic type of the instance (see TBRegistry::resolveByInstance()).
+       */
+      template<typename T>
+      RowHandle resolveByInstanceRow(T* instance) const
+      {
+         return findRow(instanceTypeKey(instance));
+      }
+
+      /**
+       * Shortcut for resolveRow<BindType>().create<Role>(args...).
+       */
+      template<typename Role, typename BindType, typename ...Args>
+      typename Role::CommonType* resolve(Args... args) const
+      {
+         return resolveRow<BindType>().template create<Role>(args...);
+      }
+
+      template<typename Role, typename CreatedType, bool isConstructible, typename...FactoryArgs>
+      struct IntermediateReturn
+      {
+         using CommonType = typename Role::CommonType;
+
+         IntermediateReturn(Map& map, Entry e)
+            : container(map)
+            , entry(std::move(e))
+         {}
+
+         template<typename BindType>
+         void forType()
+         {
+            static_assert(isConstructible, "The type you want to be build (CreatedType) has no appropriate construction method. Either register it with existing constructor or factory.");
+            container[typeKey<BindType>()][roleIndex<Role>()] = std::move(entry);
+         }
+
+         template<typename...Args>
+         IntermediateReturn<Role, CreatedType, true, Args...> buildWithConstructor()
+         {
+            return IntermediateReturn<Role, CreatedType, true, Args...>(container, makeConstructorEntry<CommonType, CreatedType, Args...>());
+         }
+
+         template<typename ...Args>
+         IntermediateReturn<Role, CreatedType, true, Args...> buildWithFactory(std::function<CommonType*(Args...)> f)
+         {
+            Entry customEntry = makeEntry<CommonType, Args...>(&callCustom<CommonType, Args...>);
+            customEntry.custom.reset(makeCustomFactory(std::move(f)));
+
+            return IntermediateReturn<Role, CreatedType, true, Args...>(container, std::move(customEntry));
+         }
+
+      protected:
+
+         Map& container;
+         Entry entry;
+      };
+
+      /**
+       * Registers CreatedType as the Role of the key type given by the chained forType() call. The chain is the same as the one of TBRegistry.
+       */
+      template<typename Role, typename CreatedType>
+      IntermediateReturn< Role, CreatedType, std::is_default_constructible_v<CreatedType> > registerType()
+      {
+         using CommonType = typename Role::CommonType;
+
+         static_cast<void>(roleIndex<Role>());
+         if constexpr(std::is_default_constructible_v<CreatedType>)
+         {
+            return IntermediateReturn<Role, CreatedType, true>{container, makeConstructorEntry<CommonType, CreatedType>()};
+         }
+         else
+         {
+            return IntermediateReturn<Role, CreatedType, false>{container, Entry{}};
+         }
+      }
+
+   protected:
+      template<typename CommonType, typename ...Args>
+      static Entry makeEntry(typename Entry::template Invoker<CommonType, Args...> invoker)
+      {
+         Entry entry;
+         entry.signature = FactoryFor<CommonType*, Args...>::signatureKey();
+         entry.invoke = reinterpret_cast<typename Entry::GenericInvoker>(invoker);
+         return entry;
+      }
+
+      template<typename CommonType, typename CreatedType, typename ...Args>
+      static Entry makeConstructorEntry()
+      {
+         return makeEntry<CommonType, Args...>(&construct<CommonType, CreatedType, Args...>);
+      }
+
+      template<typename CommonType, typename CreatedType, typename ...Args>
+      static CommonType* construct(const Entry&, std::decay_t<Args>&... args)
+      {
+         return new CreatedType(args...);
+      }
+
+      template<typename CommonType, typename ...Args>
+      static CommonType* callCustom(const Entry& entry, std::decay_t<Args>&... args)
+      {
+         return static_cast<FactoryFor<CommonType*, Args...>*>(entry.custom.get())->f(args...);
+      }
+
+      RowHandle findRow(const Key& key) const
+      {
+         auto it = container.find(key);
+         return RowHandle{it == container.end() ? nullptr : &it->second};
+      }
+
+      Map container; //< Map of the key types to the rows of the role factories.
+   };
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <type_traits>
+#include <functional>
+#include <cstddef>
+
+/**
+ * FIOC_NO_RTTI selects the RTTI-free type identities. It is detected from the compiler flags (-fno-rtti, /GR-)
+ * when not defined by the user. Define it explicitly to use the generated identities even with RTTI enabled.
+ */
+#if !defined(FIOC_NO_RTTI)
+#  if defined(__clang__)
+#     if !__has_feature(cxx_rtti)
+#        define FIOC_NO_RTTI
+#     endif
+#  elif defined(__GNUC__)
+#     if !defined(__GXX_RTTI)
+#        define FIOC_NO_RTTI
+#     endif
+#  elif defined(_MSC_VER)
+#     if !defined(_CPPRTTI)
+#        define FIOC_NO_RTTI
+#     endif
+#  endif
+#endif
+
+#if !defined(FIOC_NO_RTTI)
+#include <typeindex>
+#endif
+
+namespace fioc
+{
+#if defined(FIOC_NO_RTTI)
+   /**
+    * RTTI-free replacement for the std::type_index. The identity of the type is the address of a static
+    * variable instantiated once per type (see typeKey()), so the comparison and hashing is just a pointer operation.
+    */
+   class TypeKey
+   {
+   public:
+      constexpr explicit TypeKey(const void* id) : id(id) {}
+
+      bool operator==(const TypeKey& other) const { return id == other.id; }
+      bool operator!=(const TypeKey& other) const { return id != other.id; }
+      bool operator<(const TypeKey& other) const { return std::less<const void*>{}(id, other.id); }
+      bool operator>(const TypeKey& other) const { return other < *this; }
+      bool operator<=(const TypeKey& other) const { return !(other < *this); }
+      bool operator>=(const TypeKey& other) const { return !(*this < other); }
+
+      std::size_t hash_code() const { return std::hash<const void*>{}(id); }
+
+   protected:
+      const void* id;
+   };
+
+   namespace detail
+   {
+      /**
+       * The address of id is the identity of T. It must not be const: the linkers folding identical read-only data
+       * (MSVC /OPT:ICF, --icf=all) could give all the constant tags one address and every key would compare equal.
+       * A mutable object always keeps its own address.
+       */
+      template<typename T>
+      struct TypeTag
+      {
+         static inline char id;
+      };
+   }
+
+   /**
+    * Returns the key identifying type T. Top-level cv-qualifiers are ignored the same way typeid does.
+    */
+   template<typename T>
+   TypeKey typeKey()
+   {
+      return TypeKey{&detail::TypeTag<std::remove_cv_t<T>>::id};
+   }
+#else
+   using TypeKey = std::type_index;
+
+   /**
+    * Returns the key identifying type T. Top-level cv-qualifiers are ignored the same way typeid does.
+    */
+   template<typename T>
+   TypeKey typeKey()
+   {
+      return TypeKey{typeid(T)};
+   }
+#endif
+
+   namespace detail
+   {
+      template<typename T, typename = void>
+      struct HasTypeKeyHook : std::false_type {};
+
+      template<typename T>
+      struct HasTypeKeyHook<T, std::void_t<decltype(std::declval<const T&>().fiocTypeKey())>> : std::true_type {};
+   }
+
+   /**
+    * Returns the key of the dynamic type of the instance (what typeid(*instance) would give).
+    * With RTTI it is typeid. Without RTTI the polymorphic types need the opt-in hook declared by FIOC_TYPE_KEY and the
+    * non-polymorphic types resolve to their static type.
+    */
+   template<typename T>
+   TypeKey instanceTypeKey(const T* instance)
+   {
+#if defined(FIOC_NO_RTTI)
+      if constexpr(detail::HasTypeKeyHook<T>::value)
+      {
+         return instance->fiocTypeKey();
+      }
+      else
+      {
+         static_assert(!std::is_polymorphic_v<T>, "Polymorphic type used as an instance key without RTTI. Add FIOC_TYPE_KEY(Class) to the class and to every subclass you want to resolve by.");
+         return typeKey<T>();
+      }
+#else
+      return TypeKey{typeid(*instance)};
+#endif
+   }
+}
+
+#if defined(FIOC_NO_RTTI)
+namespace std
+{
+   template<>
+   struct hash<fioc::TypeKey>
+   {
+      std::size_t operator()(const fioc::TypeKey& key) const noexcept { return key.hash_code(); }
+   };
+}
+#endif
+
+/**
+ * Declares the virtual type key hook used by resolveByInstance() without RTTI (with RTTI the hook is ignored and typeid is used).
+ * Put it to the public section of the base class and of every subclass that should be distinguishable, otherwise the nearest
+ * base with the hook is reported.
+ * \code{.cpp}
+ * class Shape { public: FIOC_TYPE_KEY(Shape) virtual ~Shape() = default; };
+ * class Circle : public Shape { public: FIOC_TYPE_KEY(Circle) };
+ * \endcode
+ */
+#define FIOC_TYPE_KEY(Class) \
+   virtual ::fioc::TypeKey fiocTypeKey() const { return ::fioc::typeKey<Class>(); }
@@ -1,15 +1,74 @@
 #pragma once
 
+#include <FIoC/TypeKey.h>
+
 #include <type_traits>
 #include <functional>
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <mutex>
 
 namespace fioc
 {
+   /**
+    * Allocator for std::allocate_shared that takes the memory from the pool shared by the registry (see Registry::setSharedPool()).
+    * It keeps the pool alive so the objects may outlive the registry.
+    */
+   template<typename T>
+   class PoolAllocator
+   {
+   public:
+      using value_type = T;
+
+      explicit PoolAllocator(std::shared_ptr<std::pmr::memory_resource> pool)
+         : pool(std::move(pool))
+      {}
+
+      template<typename U>
+      PoolAllocator(const PoolAllocator<U>& other)
+         : pool(other.pool)
+      {}
+
+      T* allocate(std::size_t n)
+      {
+         return static_cast<T*>(pool->allocate(n * sizeof(T), alignof(T)));
+      }
+
+      void deallocate(T* p, std::size_t n)
+      {
+         pool->deallocate(p, n * sizeof(T), alignof(T));
+      }
+
+      template<typename U>
+      bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+      template<typename U>
+      bool operator!=(const PoolAllocator<U>& other) const { return pool != other.pool; }
+
+      std::shared_ptr<std::pmr::memory_resource> pool;
+   };
+
    /**
     * Common class for functors so that we can specify a type for the container value.
+    * It remembers the signature of the concrete functor so the resolve calls can check it without RTTI.
     */
    class DefaultConstructorFunctor
    {
+   public:
+      explicit DefaultConstructorFunctor(TypeKey signature)
+         : signature(signature)
+         , implementation(typeKey<void>())
+      {}
+
+      virtual ~DefaultConstructorFunctor() = default; //< The container owns the functors through this base.
+
+      TypeKey signature;
+      TypeKey implementation; //< The type that is actually constructed or void when unknown (custom factory).
+      std::size_t size = 0; //< sizeof of the implementation type or 0 when it can't be constructed in place.
+      std::size_t alignment = 0; //< alignof of the implementation type or 0 when it can't be constructed in place.
+      bool weakSingleton = false; //< The shared resolves return the living instance instead of creating a new one.
    };
 
 
@@ -18,23 +77,129 @@ namespace fioc
     * This allows you to call the function you don't know nothing about (return value, arguments) until the compile time.
     * It gives us the possibility to call an arbitrary constructor on the registered type.
     *
+    * The functors are always stored with the decayed argument types (see FactoryFor), so the resolve calls deducing
+    * the by-value arguments find the factories registered with the reference arguments. The stored functions take
+    * the arguments by the lvalue reference and pass them on as lvalues, so the reference parameters of the registered
+    * constructors and factories still bind to the arguments of the resolve call.
+    *
     * \tparam R Return type.
-    * \tparam ARGS Call arguments.
+    * \tparam ARGS Call arguments (decayed).
     */
    template <typename R, typename ...ARGS>
    class FactoryFunctor : public DefaultConstructorFunctor
    {
+      static_assert((std::is_same_v<ARGS, std::decay_t<ARGS>> && ...), "FactoryFunctor takes decayed argument types. Use FactoryFor.");
+
    public:
-      std::function<R(ARGS...)> f;
+      FactoryFunctor()
+         : DefaultConstructorFunctor(signatureKey())
+      {}
+
+      /**
+       * Key of the call signature. It is the type of the functor, so the functor found by the key can be cast to it.
+       */
+      static TypeKey signatureKey()
+      {
+         return typeKey<FactoryFunctor>();
+      }
+
+      using Type = std::remove_pointer_t<R>;
+      using Pool = std::shared_ptr<std::pmr::memory_resource>;
+
+      /**
+       * Creates the object owned by the shared_ptr. The object and the control block are allocated together (from the pool when
+       * supplied) when the functor knows the implementation type. The custom factories (f only) need the second allocation.
+       * The weak singleton returns the instance created before while anybody holds it. Its lookup and creation are guarded
+       * by the mutex of the functor, so the concurrent calls get one instance.
+       */
+      std::shared_ptr<Type> createShared(const Pool& pool, ARGS&... args)
+      {
+         if(!weakSingleton)
+         {
+            return createNew(pool, args...);
+         }
+
+         std::lock_guard<std::mutex> lock(singletonMutex);
+         if(std::shared_ptr<Type> living = singleton.lock())
+         {
+            return living;
+         }
+         std::shared_ptr<Type> created = createNew(pool, args...);
+         singleton = created;
+         return created;
+      }
+
+      std::function<R(ARGS&...)> f;
+      std::function<R(void*, ARGS&...)> place; //< Constructs the object in the supplied storage. Empty when size is 0.
+      std::function<void(void*, ARGS&...)> emplace; //< Constructs the object into the supplied std::optional of the implementation type. Empty for custom factories.
+      std::function<std::shared_ptr<Type>(const Pool&, ARGS&...)> share; //< Creates the object with the allocate_shared. Empty for custom factories.
+      std::weak_ptr<Type> singleton;
+      std::mutex singletonMutex; //< Guards singleton.
+
+   protected:
+      std::shared_ptr<Type> createNew(const Pool& pool, ARGS&... args)
+      {
+         std::shared_ptr<Type> created;
+         if(share)
+         {
+            created = share(pool, args...);
+         }
+         else if constexpr(!std::is_void_v<Type>)
+         {
+            created.reset(f(args...));
+         }
+         return created;
+      }
    };
 
+   /**
+    * The functor type stored for the factories taking ARGS and the one the resolve calls with the arguments ARGS look for.
+    */
    template <typename R, typename ...ARGS>
-   class NullFactory : public FactoryFunctor<R, ARGS...>
+   using FactoryFor = FactoryFunctor<R, std::decay_t<ARGS>...>;
+
+   template <typename R, typename ...ARGS>
+   class NullFactory : public FactoryFor<R, ARGS...>
    {
    public:
-      NullFactory() : FactoryFunctor<R, ARGS...>()
+      NullFactory() : FactoryFor<R, ARGS...>()
       {
-         this->f = [](ARGS... args) {return nullptr; };
+         this->f = [](std::decay_t<ARGS>&...) {return nullptr; };
       }
    };
-}
\ No newline at end of file
+
+   /**
+    * Creates the functor constructing Impl with the constructor taking ARGS (both on the heap and in place) and returning it as R*.
+    */
+   template<typename R, typename Impl, typename ...ARGS>
+   FactoryFor<R*, ARGS...>* makeConstructorFactory()
+   {
+      FactoryFor<R*, ARGS...> *factoryFunctor = new FactoryFor<R*, ARGS...>();
+      factoryFunctor->f = [](std::decay_t<ARGS>&... args) -> R* { return new Impl(args...); };
+      factoryFunctor->place = [](void* storage, std::decay_t<ARGS>&... args) -> R* { return new(storage) Impl(args...); };
+      factoryFunctor->emplace = [](void* optional, std::decay_t<ARGS>&... args) { static_cast<std::optional<Impl>*>(optional)->emplace(args...); };
+      factoryFunctor->share = [](const std::shared_ptr<std::pmr::memory_resource>& pool, std::decay_t<ARGS>&... args) -> std::shared_ptr<R>
+      {
+         if(pool)
+         {
+            return std::allocate_shared<Impl>(PoolAllocator<Impl>{pool}, args...);
+         }
+         return std::make_shared<Impl>(args...);
+      };
+      factoryFunctor->implementation = typeKey<Impl>();
+      factoryFunctor->size = sizeof(Impl);
+      factoryFunctor->alignment = alignof(Impl);
+      return factoryFunctor;
+   }
+
+   /**
+    * Creates the functor calling the custom factory f (buildWithFactory()).
+    */
+   template<typename R, typename ...ARGS>
+   FactoryFor<R, ARGS...>* makeCustomFactory(std::function<R(ARGS...)> f)
+   {
+      FactoryFor<R, ARGS...> *factoryFunctor = new FactoryFor<R, ARGS...>();
+      factoryFunctor->f = [f = std::move(f)](std::decay_t<ARGS>&... args) -> R { return f(args...); };
+      return factoryFunctor;
+   }
+}
@@ -0,0 +1,34 @@
+#include "StaticRegistrations.h"
+
+#include <FIoC/StaticRegistration.h>
+
+namespace
+{
+   class Triangle : public Shape
+   {
+   public:
+      FIOC_TYPE_KEY(Triangle)
+
+      Triangle(int sides = 3) : count(sides) {}
+      int sides() override {return count;}
+
+      int count;
+   };
+
+   class SquareView : public ShapeView
+   {
+   public:
+      SquareView(int id = 10) : viewId(id) {}
+      int id() override {return viewId;}
+
+      int viewId;
+   };
+}
+
+FIOC_REGISTER_TYPE(StaticTypes, Shape, Triangle);
+FIOC_REGISTER_TYPE_FOR(StaticViews, ShapeView, SquareView, Square);
+FIOC_REGISTER_TYPE_FOR(StaticViews, ShapeView, SquareView, Triangle, int);
+
+void linkStaticRegistrations()
+{
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <FIoC/TypeKey.h>
+
+/**
+ * Types shared by main.cpp and StaticRegistrations.cpp. The implementations live only in StaticRegistrations.cpp
+ * and get to main.cpp through the static registration lists.
+ */
+struct StaticTypes;
+struct StaticViews;
+
+/**
+ * Anchor of StaticRegistrations.cpp. Calling it keeps the file and its registrations linked even from a static library.
+ */
+void linkStaticRegistrations();
+
+class Shape
+{
+public:
+   FIOC_TYPE_KEY(Shape)
+
+   virtual ~Shape(){}
+   virtual int sides() = 0;
+};
+
+class Square : public Shape
+{
+public:
+   FIOC_TYPE_KEY(Square)
+
+   int sides() override {return 4;}
+};
+
+class ShapeView
+{
+public:
+   virtual ~ShapeView(){}
+   virtual int id() = 0;
+};
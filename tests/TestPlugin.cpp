@@ -0,0 +1,31 @@
+#include "TestPlugin.h"
+
+#include <FIoC/FIoC.h>
+#include <FIoC/ModuleManifest.h>
+
+namespace
+{
+   class ZipCodec : public Codec
+   {
+   public:
+      FIOC_TYPE_KEY(ZipCodec)
+
+      int id() override {return 42;}
+   };
+
+   class RawCodecView : public CodecView
+   {
+   public:
+      int codecId() override {return 1;}
+   };
+}
+
+FIOC_MODULE_ENTRY void registerCodecs(fioc::Registry<std::map>& registry)
+{
+   registry.registerType<Codec>().as<ZipCodec>();
+}
+
+FIOC_MODULE_ENTRY void registerCodecViews(fioc::TBRegistry<std::map, CodecView>& registry)
+{
+   registry.registerType<RawCodecView>().forType<RawCodec>();
+}
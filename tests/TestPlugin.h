@@ -0,0 +1,33 @@
+#pragma once
+
+#include <FIoC/TypeKey.h>
+
+#include <map>
+
+/**
+ * Types shared by main.cpp and the test plugin (TestPlugin.cpp). The implementations live only in the plugin
+ * that gets loaded on the first resolve.
+ */
+class Codec
+{
+public:
+   FIOC_TYPE_KEY(Codec)
+
+   virtual ~Codec(){}
+   virtual int id() = 0;
+};
+
+class RawCodec : public Codec
+{
+public:
+   FIOC_TYPE_KEY(RawCodec)
+
+   int id() override {return 1;}
+};
+
+class CodecView
+{
+public:
+   virtual ~CodecView(){}
+   virtual int codecId() = 0;
+};
@@ -0,0 +1,227 @@
+#include <FIoC/FIoC.h>
+#include <iostream>
+#include <memory>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+class Base
+{
+public:
+   FIOC_TYPE_KEY(Base)
+
+   virtual ~Base(){}
+   virtual int get(){return 0;}
+};
+
+class Impl : public Base
+{
+public:
+   FIOC_TYPE_KEY(Impl)
+
+   int get() override {return 1;}
+};
+
+class View
+{
+public:
+   virtual ~View(){}
+   virtual int get(){return 2;}
+};
+
+class Point final
+{
+public:
+   Point(int x = 1, int y = 2) : x(x), y(y) {}
+   int get(){return x + y;}
+   int x, y;
+};
+
+struct BenchTypes;
+
+struct ViewRole
+{
+   using CommonType = View;
+};
+
+struct ControllerRole
+{
+   using CommonType = View;
+};
+
+template<int N>
+class NumberedKey
+{
+};
+
+template<int N>
+inline const fioc::StaticRegistration<BenchTypes> numberedKeyRegistration{fioc::Bind<NumberedKey<N>>{}};
+
+/**
+ * Runs f iterations times and prints the average time of one operation (opsPerCall operations are done by one call).
+ * The sum of the results is printed too so the compiler can't throw the work away.
+ */
+template<typename F>
+void measure(const char* name, unsigned iterations, F f, unsigned opsPerCall = 1)
+{
+   long long sum = 0;
+   auto start = chrono::steady_clock::now();
+   for(unsigned i = 0; i < iterations; ++i)
+   {
+      sum += f();
+   }
+   auto end = chrono::steady_clock::now();
+   double ns = chrono::duration<double, nano>(end - start).count() / (double(iterations) * opsPerCall);
+   cout << name << ": " << ns << " ns/op (" << sum << ")" << endl;
+}
+
+/**
+ * Registers NumberedKey<0..N> one by one like the application startup code does.
+ */
+template<template <typename ... > class _Map, int ...N>
+int registerChained(std::integer_sequence<int, N...>)
+{
+   fioc::Registry<_Map> registry;
+   (registry.template registerType<NumberedKey<N>>(), ...);
+   (static_cast<void>(&numberedKeyRegistration<N>), ...); // instantiates the static registrations used by registerStatic()
+   return registry.template resolve<NumberedKey<0>>() ? 1 : 0;
+}
+
+template<template <typename ... > class _Map>
+int registerStatic()
+{
+   fioc::Registry<_Map> registry;
+   registry.template registerStatic<BenchTypes>();
+   return registry.template resolve<NumberedKey<0>>() ? 1 : 0;
+}
+
+template<template <typename ... > class _Map>
+void run(const char* mapName, unsigned iterations)
+{
+   cout << mapName << endl;
+
+   fioc::Registry<_Map> registry;
+   registry.template registerType<Base>().template as<Impl>();
+   measure("  Registry::resolve", iterations, [&registry]() {
+      unique_ptr<Base> b(registry.template resolve<Base>());
+      return b->get();
+   });
+   measure("  Registry::resolveInto", iterations, [&registry]() {
+      alignas(Impl) unsigned char storage[sizeof(Impl)];
+      Base* b = registry.template resolveInto<Base>(storage);
+      int result = b->get();
+      b->~Base();
+      return result;
+   });
+
+   measure("  Registry::resolve into shared_ptr", iterations, [&registry]() {
+      shared_ptr<Base> b(registry.template resolve<Base>());
+      return b->get();
+   });
+   measure("  Registry::resolveShared", iterations, [&registry]() {
+      return registry.template resolveShared<Base>()->get();
+   });
+   registry.setSharedPool(make_shared<std::pmr::unsynchronized_pool_resource>());
+   measure("  Registry::resolveShared (pool)", iterations, [&registry]() {
+      return registry.template resolveShared<Base>()->get();
+   });
+   registry.setSharedPool(nullptr);
+
+   registry.template registerType<Point>();
+   measure("  Registry::resolve (small type)", iterations, [&registry]() {
+      unique_ptr<Point> p(registry.template resolve<Point>());
+      return p->get();
+   });
+   measure("  Registry::resolveValue (small type)", iterations, [&registry]() {
+      return registry.template resolveValue<Point>()->get();
+   });
+
+   fioc::TBRegistry<_Map, View> tbRegistry;
+   tbRegistry.template registerType<View>().template forType<Impl>();
+   measure("  TBRegistry::resolve", iterations, [&tbRegistry]() {
+      unique_ptr<View> v(tbRegistry.template resolve<Impl>());
+      return v->get();
+   });
+
+   const unsigned registrations = fioc::StaticRegistration<BenchTypes>::size();
+   unsigned registryBuilds = max(iterations / registrations, 1u);
+   measure("  registerType chain", registryBuilds, []() {
+      return registerChained<_Map>(std::make_integer_sequence<int, 256>{});
+   }, registrations);
+   measure("  registerStatic", registryBuilds, []() {
+      return registerStatic<_Map>();
+   }, registrations);
+
+   unique_ptr<Base> instance(make_unique<Impl>());
+   measure("  TBRegistry::resolveByInstance", iterations, [&tbRegistry, &instance]() {
+      unique_ptr<View> v(tbRegistry.resolveByInstance(instance.get()));
+      return v->get();
+   });
+
+   // two roles for one key: two registries (two lookups) against one row
+   fioc::TBRegistry<_Map, View> controllers;
+   controllers.template registerType<View>().template forType<Impl>();
+   measure("  TBRegistry::resolveByInstance x2 registries", iterations, [&tbRegistry, &controllers, &instance]() {
+      unique_ptr<View> v(tbRegistry.resolveByInstance(instance.get()));
+      unique_ptr<View> c(controllers.resolveByInstance(instance.get()));
+      return v->get() + c->get();
+   });
+   fioc::TBRowRegistry<_Map, fioc::Roles<ViewRole, ControllerRole>> rows;
+   rows.template registerType<ViewRole, View>().template forType<Impl>();
+   rows.template registerType<ControllerRole, View>().template forType<Impl>();
+   measure("  TBRowRegistry::resolveByInstanceRow + 2 roles", iterations, [&rows, &instance]() {
+      auto row = rows.resolveByInstanceRow(instance.get());
+      unique_ptr<View> v(row.template create<ViewRole>());
+      unique_ptr<View> c(row.template create<ControllerRole>());
+      return v->get() + c->get();
+   });
+
+   // batches of mixed instances, the time is per one instance
+   tbRegistry.template registerType<View>().template forType<Base>();
+   const unsigned batchSize = 1000;
+   vector<unique_ptr<Base>> owned;
+   vector<Base*> instances;
+   for(unsigned i = 0; i < batchSize; ++i)
+   {
+      owned.push_back(i % 3 ? make_unique<Base>() : make_unique<Impl>());
+      instances.push_back(owned.back().get());
+   }
+   vector<View*> views(batchSize);
+   unsigned batches = max(iterations / batchSize, 1u);
+   measure("  TBRegistry::resolveByInstance loop", batches, [&tbRegistry, &instances, &views]() {
+      for(size_t i = 0; i < instances.size(); ++i)
+      {
+         views[i] = tbRegistry.resolveByInstance(instances[i]);
+      }
+      int sum = 0;
+      for(View* v : views) { sum += v->get(); delete v; }
+      return sum;
+   }, batchSize);
+   measure("  TBRegistry::resolveByInstances", batches, [&tbRegistry, &instances, &views]() {
+      tbRegistry.resolveByInstances(instances.begin(), instances.end(), views.begin());
+      int sum = 0;
+      for(View* v : views) { sum += v->get(); delete v; }
+      return sum;
+   }, batchSize);
+}
+
+int main(int argc, char* argv[])
+{
+   unsigned iterations = argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 1000000;
+
+#ifdef FIOC_NO_RTTI
+   cout << "RTTI: off" << endl;
+#else
+   cout << "RTTI: on" << endl;
+#endif
+
+   run<std::map>("std::map", iterations);
+   run<std::unordered_map>("std::unordered_map", iterations);
+
+   return 0;
+}
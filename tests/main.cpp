@@ -1,13 +1,26 @@
 #include <FIoC/FIoC.h>
+#include "StaticRegistrations.h"
+#include "TestPlugin.h"
+#include <FIoC/ModuleManifest.h>
+#include <FIoC/Parallel.h>
 #include <iostream>
 #include <memory>
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+#include <string>
+#include <cctype>
 
 using namespace std;
 
 class A
 {
 public:
+   FIOC_TYPE_KEY(A)
+
    A()
    {}
 
@@ -26,6 +39,8 @@ public:
 class C:public A
 {
 public:
+   FIOC_TYPE_KEY(C)
+
    int get() override
    {
       return 2;
@@ -129,6 +144,7 @@ public:
 
 };
 
+#ifndef FIOC_NO_RTTI
 class MyKey: public string
 {
 public:
@@ -143,6 +159,7 @@ public:
       return out << v.c_str();
    }
 };
+#endif
 
 
 template<typename _ReturnType, typename ...Arguments>
@@ -189,6 +206,7 @@ public:
 };
 
 
+#ifndef FIOC_NO_RTTI
 class Creator
 {
 public:
@@ -210,6 +228,7 @@ public:
 
    Selector create;
 };
+#endif
 
 class PDMSugar : fioc::Registry<std::map>
 {
@@ -269,6 +288,51 @@ public:
    }
 };
 
+FIOC_REGISTER_TYPE(StaticTypes, Square);
+
+struct ViewRole
+{
+   using CommonType = A;
+};
+
+struct ControllerRole
+{
+   using CommonType = NoDefaultCtor;
+};
+
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+   unsigned allocations = 0;
+
+protected:
+   void* do_allocate(size_t bytes, size_t alignment) override
+   {
+      ++allocations;
+      return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+   }
+
+   void do_deallocate(void* p, size_t bytes, size_t alignment) override
+   {
+      std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+   }
+
+   bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+   {
+      return this == &other;
+   }
+};
+
+class Counted final
+{
+public:
+   Counted() { ++alive; }
+   Counted(const Counted&) { ++alive; }
+   ~Counted() { --alive; }
+
+   static inline int alive = 0;
+};
+
 class RefCtor
 {
 public:
@@ -279,9 +343,49 @@ public:
 };
 
 
+/**
+ * Passes the output to the original buffer and counts the printed "false" words. Every check prints its result
+ * with boolalpha, so the count is the number of the failed checks and main reports it through the exit code.
+ */
+class FailureCounter : public std::streambuf
+{
+public:
+   explicit FailureCounter(std::streambuf* out) : out(out) {}
+
+   unsigned failures() const { return count + (word == "false" ? 1 : 0); }
+
+protected:
+   int overflow(int c) override
+   {
+      if(traits_type::eq_int_type(c, traits_type::eof()))
+      {
+         return traits_type::not_eof(c);
+      }
+      if(isalpha(c))
+      {
+         word.push_back(traits_type::to_char_type(c));
+      }
+      else
+      {
+         count += word == "false" ? 1 : 0;
+         word.clear();
+      }
+      return out->sputc(traits_type::to_char_type(c));
+   }
+
+   int sync() override { return out->pubsync(); }
+
+   std::streambuf* out;
+   std::string word;
+   unsigned count = 0;
+};
+
 int main(int argc, char* argv[])
 {
+   FailureCounter failureCounter(cout.rdbuf());
+   std::streambuf* console = cout.rdbuf(&failureCounter);
    cout << std::boolalpha;
+#ifndef FIOC_NO_RTTI
    ///
    TypeProvider tpr;
    TypeProviderSub1 tps1;
@@ -294,6 +398,7 @@ int main(int argc, char* argv[])
    ///
    AgregateUser<TemplateAgregatePOC<A,B> > agrPOC;
    cout << "Agregate " << typeid(decltype(agrPOC)::CT).name() << " " << typeid(decltype(agrPOC)::T).name() << endl;
+#endif
    ///
    //Increment i(0);
    cout << "increment " << Increment()()()()()() << endl;
@@ -373,6 +478,58 @@ int main(int argc, char* argv[])
    nrRef.reset(static_cast<RefCtor*>(nrBuilder.resolveByInstance(aa.get(),z)));
    cout << "Reference in Ctor " << nrRef->get() << " " << (nrRef->get() == 5) << endl;
    
+   fioc::TBRegistry<std::unordered_map, A> hashedBuilder;
+   hashedBuilder.registerType<C>().forType<C>();
+   unique_ptr<A> hbi(hashedBuilder.resolveByInstance(ac.get()));
+   cout << "hashed nrbi " << (hbi && hbi->get() == 2) << endl;
+   unique_ptr<A> hbi2(hashedBuilder.resolveByInstance(aa.get()));
+   cout << "hashed nrbi null " << (hbi2 == nullptr) << endl;
+   cout << "typeKey cv " << (fioc::typeKey<const A>() == fioc::typeKey<A>()) << endl;
+   cout << "typeKey distinct " << (fioc::typeKey<A>() != fioc::typeKey<C>()) << endl;
+
+   hashedBuilder.registerType<A>().forType<A>();
+   vector<A*> instances{ac.get(), aa.get(), nullptr, ac.get(), aa.get(), ac.get()};
+   vector<A*> batch(instances.size());
+   hashedBuilder.resolveByInstances(instances.begin(), instances.end(), batch.begin());
+   vector<A*> parallelBatch(instances.size());
+   auto batchEnd = hashedBuilder.resolveByInstances(fioc::Parallel{3}, instances.begin(), instances.end(), parallelBatch.begin());
+   bool batchOk = batchEnd == parallelBatch.end();
+   for(size_t i = 0; i < instances.size(); ++i)
+   {
+      unique_ptr<A> built(batch[i]);
+      unique_ptr<A> parallelBuilt(parallelBatch[i]);
+      int expected = !instances[i] ? 0 : instances[i]->get();
+      batchOk = batchOk && (built ? built->get() : 0) == expected && (parallelBuilt ? parallelBuilt->get() : 0) == expected;
+   }
+   cout << "batch nrbi " << batchOk << endl;
+   vector<unique_ptr<A>> ownedInstances;
+   ownedInstances.push_back(make_unique<C>());
+   A* ownedBatch[1];
+   hashedBuilder.resolveByInstances(ownedInstances.begin(), ownedInstances.end(), ownedBatch);
+   unique_ptr<A> ownedResult(ownedBatch[0]);
+   cout << "batch smart pointers " << (ownedResult && ownedResult->get() == 2) << endl;
+
+   fioc::TBRegistry<std::map, A> throwingBuilder;
+   throwingBuilder.registerType<A>().forType<A>();
+   throwingBuilder.registerType<A>().buildWithFactory({[]() -> A* { throw runtime_error("factory failed"); }}).forType<C>();
+   vector<A*> throwingInstances{aa.get(), aa.get(), ac.get(), aa.get()};
+   vector<A*> throwingBatch(throwingInstances.size(), nullptr);
+   bool rethrown = false;
+   try
+   {
+      throwingBuilder.resolveByInstances(fioc::Parallel{2}, throwingInstances.begin(), throwingInstances.end(), throwingBatch.begin());
+   }
+   catch(const runtime_error&)
+   {
+      rethrown = true;
+   }
+   bool otherPartBuilt = throwingBatch[0] && throwingBatch[1];
+   for(A* built : throwingBatch)
+   {
+      unique_ptr<A> owned(built);
+   }
+   cout << "batch parallel exception " << rethrown << " " << otherPartBuilt << endl;
+
    /////////////////////////////
    
    fioc::Registry<std::map> builder;
@@ -433,6 +590,138 @@ int main(int argc, char* argv[])
    unique_ptr<NoDefaultCtor> n5(builder.resolve<NoDefaultCtor>(7));
    cout << "NoDef " << (n5->get() == 9) << endl;
 
+   builder.registerType<A>().as<C>();
+   alignas(std::max_align_t) unsigned char storage[64];
+   cout << "sizeOf " << (builder.sizeOf<A>() == sizeof(C)) << " " << (builder.alignOf<A>() == alignof(C)) << endl;
+   A* inPlace = builder.resolveInto<A>(storage);
+   cout << "A into C " << (inPlace && inPlace->get() == 2 && static_cast<void*>(inPlace) == storage) << endl;
+   inPlace->~A();
+
+   builder.registerType<B>().buildWithConstructor<int>();
+   B* bInPlace = builder.resolveInto<B>(storage, 12);
+   cout << "B into " << (bInPlace && bInPlace->get() == 12) << endl;
+   cout << "B into wrong args null " << (builder.resolveInto<B>(storage) == nullptr) << endl;
+
+   optional<B> bValue = builder.resolveValue<B>(32);
+   cout << "B value " << (bValue && bValue->get() == 32) << endl;
+   builder.registerType<Counted>();
+   {
+      optional<Counted> countedValue = builder.resolveValue<Counted>();
+      cout << "value alive " << (countedValue && Counted::alive == 1) << endl;
+   }
+   cout << "value destroyed " << (Counted::alive == 0) << endl;
+
+   builder.registerType<NoDefaultCtor>().as<NoDefaultCtorSub>().buildWithConstructor<int,int>();
+   cout << "NoDef value as other type empty " << !builder.resolveValue<NoDefaultCtor>(3, 4).has_value() << endl;
+   cout << "NoDef sizeOf " << (builder.sizeOf<NoDefaultCtor>() == sizeof(NoDefaultCtorSub)) << endl;
+
+   builder.registerType<NoDefaultCtorSub>().buildWithFactory({Factory::create});
+   cout << "factory into null " << (builder.resolveInto<NoDefaultCtorSub>(storage) == nullptr) << " " << (builder.sizeOf<NoDefaultCtorSub>() == 0) << endl;
+   optional<NoDefaultCtorSub> subValue = builder.resolveValue<NoDefaultCtorSub>();
+   cout << "factory value empty " << !subValue.has_value() << endl;
+   cout << "unregistered value empty " << !builder.resolveValue<D>().has_value() << endl;
+
+   builder.registerType<A>().as<C>();
+   shared_ptr<A> sharedA = builder.resolveShared<A>();
+   cout << "shared A as C " << (sharedA && sharedA->get() == 2 && sharedA.use_count() == 1) << endl;
+   auto countingPool = make_shared<CountingResource>();
+   builder.setSharedPool(countingPool);
+   sharedA = builder.resolveShared<A>();
+   cout << "shared pool single allocation " << (sharedA && sharedA->get() == 2 && countingPool->allocations == 1) << endl;
+   builder.setSharedPool(nullptr);
+   shared_ptr<NoDefaultCtorSub> sharedSub = builder.resolveShared<NoDefaultCtorSub>();
+   cout << "shared custom factory " << (sharedSub && sharedSub->get() == -1) << endl;
+
+   builder.registerType<B>().buildWithConstructor<int>().weakSingleton();
+   shared_ptr<B> single1 = builder.resolveShared<B>(1);
+   shared_ptr<B> single2 = builder.resolveShared<B>(2);
+   cout << "weak singleton " << (single1 && single1 == single2 && single2->get() == 1) << endl;
+   single1.reset();
+   single2.reset();
+   single1 = builder.resolveShared<B>(3);
+   cout << "weak singleton rebuilt " << (single1 && single1->get() == 3) << endl;
+   unique_ptr<B> notSingle(builder.resolve<B>(4));
+   cout << "weak singleton raw resolve " << (notSingle && notSingle.get() != single1.get() && notSingle->get() == 4) << endl;
+
+   builder.registerType<Counted>().weakSingleton();
+   vector<shared_ptr<Counted>> concurrentSingles(8);
+   {
+      vector<thread> threads;
+      for(shared_ptr<Counted>& single : concurrentSingles)
+      {
+         threads.emplace_back([&builder, &single]() { single = builder.resolveShared<Counted>(); });
+      }
+      for(thread& t : threads)
+      {
+         t.join();
+      }
+   }
+   bool sameSingle = all_of(concurrentSingles.begin(), concurrentSingles.end(), [&concurrentSingles](const shared_ptr<Counted>& single) { return single && single == concurrentSingles[0]; });
+   cout << "weak singleton concurrent " << (sameSingle && Counted::alive == 1) << endl;
+
+   fioc::TBRegistry<std::map, A> sharedViews;
+   sharedViews.registerType<C>().weakSingleton().forType<B>();
+   shared_ptr<A> view1 = sharedViews.resolveShared<B>();
+   shared_ptr<A> view2 = sharedViews.resolveSharedByInstance(&bb);
+   cout << "TB weak singleton " << (view1 && view1 == view2 && view1->get() == 2) << endl;
+   sharedViews.registerType<C>().forType<C>();
+   cout << "TB shared " << (sharedViews.resolveSharedByInstance(ac.get()) != sharedViews.resolveSharedByInstance(ac.get())) << endl;
+
+   fioc::TBRowRegistry<std::map, fioc::Roles<ViewRole, ControllerRole>> rows;
+   rows.registerType<ViewRole, C>().forType<B>();
+   rows.registerType<ControllerRole, NoDefaultCtorSub>().buildWithConstructor<int, int>().forType<B>();
+   rows.registerType<ViewRole, A>().forType<C>();
+   auto row = rows.resolveByInstanceRow(&bb);
+   unique_ptr<A> rowView(row.create<ViewRole>());
+   unique_ptr<NoDefaultCtor> rowController(row.create<ControllerRole>(5, 1));
+   cout << "row " << (row && rowView && rowView->get() == 2 && rowController && rowController->get() == 6) << endl;
+   cout << "row wrong args null " << (row.create<ControllerRole>() == nullptr) << endl;
+   auto cRow = rows.resolveByInstanceRow(ac.get());
+   unique_ptr<A> cRowView(cRow.create<ViewRole>());
+   cout << "row by instance " << (cRowView && cRowView->get() == 1 && !cRow.has<ControllerRole>() && cRow.create<ControllerRole>(1, 1) == nullptr) << endl;
+   cout << "row missing " << (!rows.resolveRow<D>() && rows.resolveRow<D>().create<ViewRole>() == nullptr) << endl;
+   unique_ptr<A> shortcutView(rows.resolve<ViewRole, B>());
+   cout << "row resolve " << (shortcutView && shortcutView->get() == 2) << endl;
+   rows.registerType<ControllerRole, NoDefaultCtorSub>().buildWithFactory<int>({[](int x) -> NoDefaultCtor* { return new NoDefaultCtorSub(x, x); }}).forType<C>();
+   unique_ptr<NoDefaultCtor> cRowController(cRow.create<ControllerRole>(2));
+   cout << "row factory " << (cRowController && cRowController->get() == 4 && cRow.create<ControllerRole>(2, 2) == nullptr) << endl;
+
+   linkStaticRegistrations();
+   fioc::Registry<std::unordered_map> staticBuilder;
+   staticBuilder.registerStatic<StaticTypes>();
+   unique_ptr<Shape> shape(staticBuilder.resolve<Shape>());
+   unique_ptr<Square> square(staticBuilder.resolve<Square>());
+   cout << "static " << (shape && shape->sides() == 3) << " " << (square && square->sides() == 4) << endl;
+
+   fioc::TBRegistry<std::map, ShapeView> staticViews;
+   staticViews.registerStatic<StaticViews>();
+   unique_ptr<ShapeView> squareView(staticViews.resolveByInstance(square.get()));
+   unique_ptr<ShapeView> triangleView(staticViews.resolveByInstance(shape.get(), 7));
+   cout << "static for " << (squareView && squareView->id() == 10) << " " << (triangleView && triangleView->id() == 7) << endl;
+
+   fioc::Registry<std::map> pluginBuilder;
+   fioc::ModuleManifest<fioc::Registry<std::map>> modules;
+   modules.add<Codec>(FIOC_TEST_PLUGIN, "registerCodecs");
+   modules.attach(pluginBuilder);
+   cout << "plugin sizeOf loads " << (pluginBuilder.sizeOf<Codec>() >= sizeof(Codec) && pluginBuilder.alignOf<Codec>() >= alignof(Codec)) << " " << modules.lastError() << endl;
+   unique_ptr<Codec> codec(pluginBuilder.resolve<Codec>());
+   cout << "plugin resolve " << (codec && codec->id() == 42) << " " << modules.lastError() << endl;
+   cout << "plugin unknown type null " << (pluginBuilder.resolve<D>() == nullptr) << endl;
+
+   fioc::TBRegistry<std::map, CodecView> pluginViews;
+   fioc::ModuleManifest<fioc::TBRegistry<std::map, CodecView>> viewModules;
+   viewModules.add<RawCodec>(FIOC_TEST_PLUGIN, "registerCodecViews");
+   viewModules.attach(pluginViews);
+   unique_ptr<Codec> rawCodec(make_unique<RawCodec>());
+   unique_ptr<CodecView> codecView(pluginViews.resolveByInstance(rawCodec.get()));
+   cout << "plugin resolveByInstance " << (codecView && codecView->codecId() == 1) << " " << viewModules.lastError() << endl;
+
+   fioc::Registry<std::map> missingBuilder;
+   fioc::ModuleManifest<fioc::Registry<std::map>> missingModules;
+   missingModules.add<Codec>("FIoC_missing_plugin.so", "registerCodecs");
+   missingModules.attach(missingBuilder);
+   cout << "missing plugin null " << (missingBuilder.resolve<Codec>() == nullptr) << " " << !missingModules.lastError().empty() << endl;
+
    //Compile-time error - which is good since not only A is not a subclass of NoDefaultCtor but it doesn't have appropriate ctor signature
    /*
    builder.registerType<NoDefaultCtor>().as<A>().buildWithConstructor<int,int>();
@@ -447,5 +736,12 @@ int main(int argc, char* argv[])
 
    
 
+   cout.flush();
+   cout.rdbuf(console);
+   if(failureCounter.failures())
+   {
+      cout << failureCounter.failures() << " checks failed" << endl;
+      return 1;
+   }
    return 0;
 }